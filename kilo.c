@@ -38,6 +38,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
@@ -45,6 +47,8 @@
 /*** defines ***/
 #define KILO_VERSION "0.0.1"
 #define KILO_TAB_STOP 8
+#define KILO_HEX_BYTES 16   // количество байт в одной строке hex-режима
+#define KILO_HEX_PROBE 4096 // сколько байт файла просматривается, чтобы решить, двоичный ли он
 
 #define CTRL_KEY(k) ((k) & 0x1f) // применение маски 00011111 к коду клавиши
 
@@ -84,6 +88,12 @@ struct editorConfig { // структура конфигурации
     int screencols;
     int numrows;
     erow *row;
+    int hexmode;    // файл показывается в hex-режиме
+    unsigned char *hexdata; // отображенное в память (mmap) содержимое файла
+    size_t hexsize; // размер отображенного файла в байтах
+    size_t hexrows; // количество строк hex-режима (в size_t, т.к. у многогигабайтных файлов их больше, чем влезает в int)
+    size_t hexcy;   // строка hex-режима, на которой находится курсор
+    size_t hexrowoff;   // первая видимая строка hex-режима
     char *filename; // имя файла
     char statusmsg[80];
     time_t statusmsg_time;
@@ -312,7 +322,83 @@ void editorAppendRow(char *s, size_t len) {
     E.row[at].rsize = 0;
     E.row[at].render = NULL;
     editorUpdateRow(&E.row[at]);
-}         
+}
+
+/*** hex view ***/
+
+int editorHexRowSize(size_t filerow) {
+    /* Возвращает количество байт в строке filerow hex-режима (последняя строка может быть неполной). */
+    if (filerow >= E.hexrows) return 0;
+    size_t start = filerow * KILO_HEX_BYTES;
+    size_t left = E.hexsize - start;
+    return left < KILO_HEX_BYTES ? (int)left : KILO_HEX_BYTES;
+}
+
+int editorHexOffsetWidth() {
+    /* Ширина столбца смещений: не меньше 8 hex-цифр, но так, чтобы влезло смещение последнего байта */
+    int w = 8;
+    size_t last = E.hexsize ? E.hexsize - 1 : 0;
+    while (w < (int)(sizeof(size_t) * 2) && (last >> (w * 4)) != 0) w++;
+    return w;
+}
+
+int editorHexCxToRx(int cx) {
+    /*
+        В hex-режиме cx - номер байта в строке, а rx - столбец его первой hex-цифры:
+        смещение, два пробела, по 3 символа на байт и лишний пробел после 8-го байта.
+    */
+    return editorHexOffsetWidth() + 2 + cx * 3 + (cx >= KILO_HEX_BYTES / 2);
+}
+
+int editorHexRender(size_t filerow, char *buf) {
+    /*
+        Рисует строку filerow в buf в виде "смещение  hex-байты  |ascii|" прямо из отображенных в память байт,
+        без выделения памяти под строки. Возвращает длину полученной строки.
+    */
+    static const char digits[] = "0123456789abcdef";
+    size_t start = filerow * KILO_HEX_BYTES;
+    int n = editorHexRowSize(filerow);
+    int offw = editorHexOffsetWidth();
+    int len = 0;
+    int j;
+
+    for (j = offw - 1; j >= 0; j--)
+        buf[len++] = digits[(start >> (j * 4)) & 0xf];
+    buf[len++] = ' ';
+    buf[len++] = ' ';
+
+    for (j = 0; j < KILO_HEX_BYTES; j++) {
+        if (j < n) {    // неполная последняя строка дополняется пробелами, чтобы ascii-столбец не съезжал
+            unsigned char c = E.hexdata[start + j];
+            buf[len++] = digits[c >> 4];
+            buf[len++] = digits[c & 0xf];
+        } else {
+            buf[len++] = ' ';
+            buf[len++] = ' ';
+        }
+        buf[len++] = ' ';
+        if (j == KILO_HEX_BYTES / 2 - 1) buf[len++] = ' ';
+    }
+
+    buf[len++] = ' ';
+    buf[len++] = '|';
+    for (j = 0; j < n; j++) {
+        unsigned char c = E.hexdata[start + j];
+        buf[len++] = (c >= 0x20 && c < 0x7f) ? c : '.';    // непечатаемые байты показываем точкой
+    }
+    buf[len++] = '|';
+    return len;
+}
+
+int editorIsBinary(const char *probe, size_t len, size_t size) {
+    /*
+        Считает файл размером size двоичным по его первым len байтам probe: если в них есть нулевой байт
+        или в файле длиннее KILO_HEX_PROBE байт они не содержат ни одного перевода строки
+        (иначе весь файл превратился бы в одну гигантскую строку).
+    */
+    if (memchr(probe, '\0', len)) return 1;
+    return size > KILO_HEX_PROBE && !memchr(probe, '\n', len);
+}
 
 /*** file i/o ***/
 
@@ -327,6 +413,31 @@ void editorOpen(char *filename) {
     FILE *fp = fopen(filename, "r");
     if (!fp) die("fopen");
 
+    /*
+        Смотрим на начало файла через pread (он не сдвигает позицию чтения fp). Если файл двоичный,
+        отображаем его в память через mmap, и строки не читаются вовсе: hex-режим рисует видимые строки
+        прямо из отображения, поэтому даже многогигабайтный файл открывается мгновенно,
+        а память тратится только на страницы, попавшие на экран.
+    */
+    int fd = fileno(fp);
+    struct stat st;
+    if (fstat(fd, &st) == -1) die("fstat");
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {    // пустые файлы и не обычные файлы mmap не поддерживают
+        char probe[KILO_HEX_PROBE];
+        ssize_t n = pread(fd, probe, sizeof(probe), 0);
+        if (n == -1) die("pread");
+        if (editorIsBinary(probe, n, st.st_size)) {
+            void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) die("mmap");
+            E.hexmode = 1;
+            E.hexdata = data;
+            E.hexsize = st.st_size;
+            E.hexrows = (E.hexsize + KILO_HEX_BYTES - 1) / KILO_HEX_BYTES;
+            fclose(fp); // отображение остается действительным и после закрытия файла
+            return;
+        }
+    }
+
     char *line = NULL;
     size_t linecap = 0;
     ssize_t linelen;
@@ -377,9 +488,15 @@ void abFree(struct abuf *ab) {
 void editorScroll() {
     /* Прокручивает экран, если курсор вышел за границы экрана. */
     E.rx = 0;
-    if (E.cy < E.numrows) {
+    if (E.hexmode) {
+        E.rx = editorHexCxToRx(E.cx);
+    } else if (E.cy < E.numrows) {
         E.rx = editorRowCxToRx(&E.row[E.cy], E.cx);
     }
+    if (E.hexmode) {    // то же самое для строк hex-режима, которые считаются в size_t
+        if (E.hexcy < E.hexrowoff) E.hexrowoff = E.hexcy;
+        if (E.hexcy >= E.hexrowoff + E.screenrows) E.hexrowoff = E.hexcy - E.screenrows + 1;
+    }
     if (E.cy < E.rowoff) {
         /* проверяет, находится ли курсор над видимым окном, и если да,
          то прокручивает его до того места, где находится курсор.*/
@@ -405,7 +522,18 @@ void editorDrawRows(struct abuf *ab) {
     int y;
     for (y = 0; y < E.screenrows; y++) {
         int filerow = y + E.rowoff; // номер строки в текстовом буфере
-        if (filerow >= E.numrows) {   //  если номер строки больше или равен кол-ва строк в текстовом буфере
+        if (E.hexmode) {
+            size_t hexrow = E.hexrowoff + y;    // номер строки hex-режима
+            if (hexrow < E.hexrows) {
+                char line[sizeof(size_t) * 2 + 2 + KILO_HEX_BYTES * 4 + 4];   // смещение, hex-байты, ascii и разделители
+                int len = editorHexRender(hexrow, line) - E.coloff;
+                if (len < 0) len = 0;
+                if (len > E.screencols) len = E.screencols;
+                abAppend(ab, &line[E.coloff], len);
+            } else {
+                abAppend(ab, "~", 1);
+            }
+        } else if (filerow >= E.numrows) {   //  если номер строки больше или равен кол-ва строк в текстовом буфере
             if (E.numrows == 0 && y == E.screenrows / 3) {    // Если Строк 0 и кол-во скрок равны трети высоты экрана
                 char welcome[80];   // буфер для приветствия
                 int welcomelen = snprintf(welcome, sizeof(welcome), 
@@ -445,8 +573,14 @@ void editorDrawStatusBar(struct abuf *ab) {
     */
     abAppend(ab, "\x1b[7m", 4); //  переключает цвета на инвертированные
     char status[80], rstatus[80];   // буферы для названия и общим кол-во срок И правой части строки состояния с количеством строк и текущей строке
-    int len = snprintf(status, sizeof(status), "%.20s - %d lines", E.filename ? E.filename : "[No Name]", E.numrows);   // строка состояния левая
-    int rlen = snprintf(rstatus, sizeof(rstatus), "%d/%d", E.cy + 1, E.numrows); // Правая часть строки состояния с количеством строк и текущей строки
+    int len, rlen;
+    if (E.hexmode) {    // в hex-режиме показываем размер файла и смещение байта под курсором
+        len = snprintf(status, sizeof(status), "%.20s - %zu bytes [hex]", E.filename, E.hexsize);
+        rlen = snprintf(rstatus, sizeof(rstatus), "0x%zx", E.hexcy * KILO_HEX_BYTES + E.cx);
+    } else {
+        len = snprintf(status, sizeof(status), "%.20s - %d lines", E.filename ? E.filename : "[No Name]", E.numrows);   // строка состояния левая
+        rlen = snprintf(rstatus, sizeof(rstatus), "%d/%d", E.cy + 1, E.numrows); // Правая часть строки состояния с количеством строк и текущей строки
+    }
     if (len > E.screencols) len = E.screencols;
     abAppend(ab, status, len);
 
@@ -502,7 +636,7 @@ void editorRefreshScreen() {
        мы вычитаем из каждого числа E.rowoff и E.coloff, чтобы вычислить смещение курсора относительно начала экрана.
     */
     snprintf(buf, sizeof(buf), "\x1b[%d;%dH", /* escape-последовательность для перемещения курсора в позиции (строка, столбец) */
-        (E.cy - E.rowoff) + 1, /* строка */
+        (E.hexmode ? (int)(E.hexcy - E.hexrowoff) : E.cy - E.rowoff) + 1, /* строка */
         (E.rx - E.coloff) + 1 /* столбец */
     );
     abAppend(&ab, buf, strlen(buf));    // перевести курсор в начало экрана
@@ -528,7 +662,52 @@ void editorSetStatusMessage(const char *fmt, ...) {
 
 /*** input ***/
 
+void editorHexMoveCursor(int key) {
+    /* Перемещение курсора в hex-режиме: курсор всегда стоит на байте файла и не уходит за последний. */
+    switch (key) {
+        case ARROW_LEFT:
+            if (E.cx != 0) {
+                E.cx--;
+            } else if (E.hexcy > 0) {
+                E.hexcy--;
+                E.cx = KILO_HEX_BYTES - 1;
+            }
+            break;
+        case ARROW_RIGHT:
+            if (E.hexcy * KILO_HEX_BYTES + E.cx + 1 < E.hexsize) {  // если справа еще есть байт
+                if (E.cx < KILO_HEX_BYTES - 1) {
+                    E.cx++;
+                } else {
+                    E.hexcy++;
+                    E.cx = 0;
+                }
+            }
+            break;
+        case ARROW_UP:
+            if (E.hexcy != 0) {
+                E.hexcy--;
+            }
+            break;
+        case ARROW_DOWN:
+            if (E.hexcy + 1 < E.hexrows) {
+                E.hexcy++;
+            }
+            break;
+    }
+
+    /* последняя строка может быть неполной, поэтому ставим курсор не дальше ее последнего байта */
+    int rowlen = editorHexRowSize(E.hexcy);
+    if (E.cx > rowlen - 1) {
+        E.cx = rowlen - 1;
+    }
+}
+
 void editorMoveCursor(int key) {
+    if (E.hexmode) {
+        editorHexMoveCursor(key);
+        return;
+    }
+
     erow *row = (E.cy >= E.numrows) ? NULL : &E.row[E.cy]; // если строка не существует то erow = NULL, иначе переменная строки будет указывать на строку, на которой находится курсор
     switch (key) {
         case ARROW_LEFT:
@@ -586,14 +765,23 @@ void editorProcessKeyPress() {
             break;
 
         case END_KEY:
-        if (E.cy < E.numrows)   // если строка существует
+        if (E.hexmode)
+                E.cx = editorHexRowSize(E.hexcy) - 1;  // последний байт строки
+        else if (E.cy < E.numrows)   // если строка существует
                 E.cx = E.row[E.cy].size;
             break;
 
         case PAGE_UP:
         case PAGE_DOWN:
             {   /* Прокрутка экрана вниз и вверх */
-                if (c == PAGE_UP) {
+                if (E.hexmode) {
+                    if (c == PAGE_UP) {
+                        E.hexcy = E.hexrowoff;
+                    } else {
+                        E.hexcy = E.hexrowoff + E.screenrows - 1;
+                        if (E.hexcy >= E.hexrows) E.hexcy = E.hexrows - 1;
+                    }
+                } else if (c == PAGE_UP) {
                     E.cy = E.rowoff;
                 } else if (c == PAGE_DOWN) {
                     E.cy = E.rowoff + E.screenrows - 1;
@@ -626,6 +814,12 @@ void initEditor() {
     E.coloff = 0;
     E.numrows = 0;
     E.row = NULL;
+    E.hexmode = 0;
+    E.hexdata = NULL;
+    E.hexsize = 0;
+    E.hexrows = 0;
+    E.hexcy = 0;
+    E.hexrowoff = 0;
     E.filename = NULL;
     E.statusmsg[0] = '\0';
     E.statusmsg_time = 0;